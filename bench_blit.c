@@ -0,0 +1,106 @@
+/*
+ * Compares the blitter against the scalar code it replaced on wide frames.
+ * Run with RLSMENU_BLIT=scalar|sse2|avx2 to force a kernel set.
+ */
+#include "blit.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ITERS 20000
+
+#define BOX_H L'─'
+#define BOX_V L'│'
+
+static volatile wchar_t sink;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// The pre-blitter frame composition, kept here as the baseline
+static void compose_old(wchar_t *str, int w, int h, wchar_t const *line) {
+    for (int i = 0; i < w * h; i++)
+        str[i] = L' ';
+
+    for (int i = 1; i < h-1; i++)
+        *wcpcpy(str+2+i*w, line) = L' ';
+
+    for (int i = 1; i < w-1; i++) {
+        str[i] = BOX_H;
+        str[i + w*(h-1)] = BOX_H;
+    }
+
+    for (int i = 1; i < h-1; i++) {
+        str[i*w] = BOX_V;
+        str[i*w+w-1] = BOX_V;
+    }
+}
+
+static void compose_new(wchar_t *str, int w, int h, wchar_t const *line) {
+    rlsmenu_blit_fill(str, L' ', w * h);
+
+    for (int i = 1; i < h-1; i++)
+        rlsmenu_blit_text(str+2+i*w, line, w-4);
+
+    rlsmenu_blit_hrun(str+1, BOX_H, w-2);
+    rlsmenu_blit_hrun(str+1+w*(h-1), BOX_H, w-2);
+    rlsmenu_blit_vrun(str+w, BOX_V, h-2, w);
+    rlsmenu_blit_vrun(str+w+w-1, BOX_V, h-2, w);
+}
+
+static double run(void (*compose)(wchar_t *, int, int, wchar_t const *),
+                  wchar_t *str, int w, int h, wchar_t const *line) {
+    double start = now();
+    for (int i = 0; i < ITERS; i++) {
+        compose(str, w, h, line);
+        sink = str[i % (w * h)];
+    }
+    return (now() - start) / ITERS * 1e9;
+}
+
+int main(void) {
+    char const *force = getenv("RLSMENU_BLIT");
+    if (force && !rlsmenu_blit_use(force)) {
+        fprintf(stderr, "kernel set '%s' is not available\n", force);
+        return 1;
+    }
+
+    int widths[] = { 80, 200, 240, 400 };
+    int h = 50;
+
+    printf("kernels: %s\n", rlsmenu_blit_impl_name());
+    printf("%6s %12s %12s %8s\n", "width", "old ns", "blit ns", "speedup");
+
+    for (size_t k = 0; k < sizeof(widths) / sizeof(*widths); k++) {
+        int w = widths[k];
+        wchar_t *a = malloc(sizeof(*a) * w * h);
+        wchar_t *b = malloc(sizeof(*b) * w * h);
+
+        // Lines cover about two thirds of the row, like a typical menu
+        int len = (w - 4) * 2 / 3;
+        wchar_t *line = malloc(sizeof(*line) * (len + 1));
+        for (int i = 0; i < len; i++)
+            line[i] = L'a' + i % 26;
+        line[len] = L'\0';
+
+        compose_old(a, w, h, line);
+        compose_new(b, w, h, line);
+        if (memcmp(a, b, sizeof(*a) * w * h)) {
+            fprintf(stderr, "output mismatch at width %d\n", w);
+            return 1;
+        }
+
+        double t_old = run(compose_old, a, w, h, line);
+        double t_new = run(compose_new, b, w, h, line);
+        printf("%6d %12.0f %12.0f %7.2fx\n", w, t_old, t_new, t_old / t_new);
+
+        free(a);
+        free(b);
+        free(line);
+    }
+}
@@ -0,0 +1,140 @@
+#include "blit.h"
+
+#include <string.h>
+#include <stdbool.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && __SIZEOF_WCHAR_T__ == 4
+#define BLIT_X86
+#include <immintrin.h>
+#endif
+
+typedef struct blit_impl {
+    char const *name;
+    void (*fill)(wchar_t *, wchar_t, size_t);
+    void (*copy)(wchar_t *, wchar_t const *, size_t);
+} blit_impl;
+
+static void fill_scalar(wchar_t *dst, wchar_t c, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        dst[i] = c;
+}
+
+static void copy_scalar(wchar_t *dst, wchar_t const *src, size_t n) {
+    memcpy(dst, src, n * sizeof(*dst));
+}
+
+static blit_impl const impl_scalar = { "scalar", fill_scalar, copy_scalar };
+
+#ifdef BLIT_X86
+__attribute__((target("sse2")))
+static void fill_sse2(wchar_t *dst, wchar_t c, size_t n) {
+    __m128i v = _mm_set1_epi32(c);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_si128((__m128i *) (dst + i), v);
+    for (; i < n; i++)
+        dst[i] = c;
+}
+
+__attribute__((target("sse2")))
+static void copy_sse2(wchar_t *dst, wchar_t const *src, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_loadu_si128((__m128i const *) (src + i)));
+    for (; i < n; i++)
+        dst[i] = src[i];
+}
+
+__attribute__((target("avx2")))
+static void fill_avx2(wchar_t *dst, wchar_t c, size_t n) {
+    __m256i v = _mm256_set1_epi32(c);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_si256((__m256i *) (dst + i), v);
+    // Finish with one overlapping store instead of a scalar tail
+    if (i < n && n >= 8)
+        _mm256_storeu_si256((__m256i *) (dst + n - 8), v);
+    else
+        for (; i < n; i++)
+            dst[i] = c;
+}
+
+__attribute__((target("avx2")))
+static void copy_avx2(wchar_t *dst, wchar_t const *src, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_si256((__m256i *) (dst + i), _mm256_loadu_si256((__m256i const *) (src + i)));
+    for (; i < n; i++)
+        dst[i] = src[i];
+}
+
+static blit_impl const impl_sse2 = { "sse2", fill_sse2, copy_sse2 };
+static blit_impl const impl_avx2 = { "avx2", fill_avx2, copy_avx2 };
+#endif
+
+// Upgraded by select_impl before main runs. Only rlsmenu_blit_use, which
+// isn't part of the library, writes it after that
+static blit_impl const *impl = &impl_scalar;
+
+// Picks the widest kernel set the CPU supports
+__attribute__((constructor))
+static void select_impl(void) {
+#ifdef BLIT_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        impl = &impl_avx2;
+    else if (__builtin_cpu_supports("sse2"))
+        impl = &impl_sse2;
+#endif
+}
+
+void rlsmenu_blit_fill(wchar_t *dst, wchar_t c, size_t n) {
+    impl->fill(dst, c, n);
+}
+
+// Strided stores have no SSE2/AVX2 equivalent, so this is scalar everywhere
+void rlsmenu_blit_vrun(wchar_t *dst, wchar_t c, size_t n, size_t stride) {
+    for (size_t i = 0; i < n; i++)
+        dst[i * stride] = c;
+}
+
+size_t rlsmenu_blit_text(wchar_t *dst, wchar_t const *src, size_t w) {
+    size_t len = wcsnlen(src, w);
+    impl->copy(dst, src, len);
+
+    return len;
+}
+
+size_t rlsmenu_blit_row(wchar_t *dst, wchar_t const *src, size_t w, wchar_t pad) {
+    blit_impl const *b = impl;
+    size_t len = wcsnlen(src, w);
+
+    b->copy(dst, src, len);
+    b->fill(dst + len, pad, w - len);
+
+    return len;
+}
+
+#ifdef RLSMENU_BLIT_BENCH
+bool rlsmenu_blit_use(char const *name) {
+#ifdef BLIT_X86
+    if (!strcmp(name, "sse2") && __builtin_cpu_supports("sse2")) {
+        impl = &impl_sse2;
+        return true;
+    }
+    if (!strcmp(name, "avx2") && __builtin_cpu_supports("avx2")) {
+        impl = &impl_avx2;
+        return true;
+    }
+#endif
+    if (!strcmp(name, "scalar")) {
+        impl = &impl_scalar;
+        return true;
+    }
+    return false;
+}
+
+char const *rlsmenu_blit_impl_name(void) {
+    return impl->name;
+}
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+#include <wchar.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Internal cell blitter used to compose frame strings. Fills and copies
+ * have scalar versions and, on x86, SSE2 and AVX2 versions; the best
+ * available set is chosen once at startup. Vertical runs are scalar
+ * everywhere.
+ */
+
+// Writes n copies of c starting at dst
+void rlsmenu_blit_fill(wchar_t *dst, wchar_t c, size_t n);
+
+// Writes n copies of c starting at dst, stepping stride cells each time
+void rlsmenu_blit_vrun(wchar_t *dst, wchar_t c, size_t n, size_t stride);
+
+/*
+ * Copies at most w cells of the null terminated src into dst, leaving the
+ * rest of the w cells untouched. Use this over a buffer that has already
+ * been filled. Returns the number of cells copied.
+ */
+size_t rlsmenu_blit_text(wchar_t *dst, wchar_t const *src, size_t w);
+
+/*
+ * Copies at most w cells of the null terminated src into dst and fills the
+ * rest of the w cells with pad. Never writes a null terminator. Returns the
+ * number of cells copied from src.
+ */
+size_t rlsmenu_blit_row(wchar_t *dst, wchar_t const *src, size_t w, wchar_t pad);
+
+// A horizontal run is a fill that doesn't cross a row boundary
+static inline void rlsmenu_blit_hrun(wchar_t *dst, wchar_t c, size_t n) {
+    rlsmenu_blit_fill(dst, c, n);
+}
+
+#ifdef RLSMENU_BLIT_BENCH
+// Name of the kernel set in use ("scalar", "sse2" or "avx2")
+char const *rlsmenu_blit_impl_name(void);
+
+/*
+ * Forces the named kernel set. Returns false if it is unknown or not
+ * supported. Only built into bench_blit; it isn't safe to call while other
+ * threads are blitting.
+ */
+bool rlsmenu_blit_use(char const *name);
+#endif
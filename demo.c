@@ -6,8 +6,11 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <poll.h>
+#include <time.h>
 
 #define ENTER 0xa
 #define ESC   0x1b
@@ -16,9 +19,14 @@
 #define PGUP  0x35
 #define PGDN  0x36
 
+#define MAX_FPS 60
+// Output budget for redraws, roughly what a 64 kbit/s link can take
+#define OUT_BYTES_PER_SEC 8192
+
 // Blocking
 int getchar() {
-    int n, c;
+    int n;
+    unsigned char c;
     while ((n = read(STDIN_FILENO, &c, 1)) == -1 && errno == EAGAIN)
         usleep(10000); // Don't peg the CPU for input (10ms)
     return n > 0 ? c : EOF;
@@ -26,7 +34,8 @@ int getchar() {
 
 // Non-blocking
 int getchar_nb() {
-    int n, c;
+    int n;
+    unsigned char c;
     n = read(STDIN_FILENO, &c, 1);
 
     if (n == 0)
@@ -89,7 +98,7 @@ enum rlsmenu_cb_res on_select(rlsmenu_frame *frame, void *selection) {
 }
 
 char *items[] = { "a", "b", "c" };
-wchar_t *item_names[] = { L"One", L"Two", L"Three" };
+wchar_t const *item_names[] = { L"One", L"Two", L"Three" };
 
 rlsmenu_slist list_tmp = {
     .s = {
@@ -117,7 +126,7 @@ rlsmenu_msgbox msgbox_tmp = {
         .cbs = &(rlsmenu_cbs) { NULL, NULL, NULL },
     },
 
-    .lines = (wchar_t *[]) {
+    .lines = (wchar_t const *[]) {
         L"Lorem ipsum dolor sit amet, consectetur adipiscing elit. Sed nisl nisi,",
         L"efficitur eu orci vel, rutrum porta ligula. Quisque eget rhoncus orci.",
         L"Vestibulum a elit ac est suscipit dictum. Sed mollis enim a turpis sodales",
@@ -128,37 +137,110 @@ rlsmenu_msgbox msgbox_tmp = {
     .n_lines = 6,
 };
 
-void draw_menu(rlsmenu_str menu_str) {
-    wprintf(L"\e[1;1H");
-    for (int i = 0; i < menu_str.w * menu_str.h; i += menu_str.w)
-        wprintf(L"%.*ls\n", menu_str.w, menu_str.str+i);
+// Frame output the terminal hasn't taken yet
+typedef struct out_queue {
+    char *buf;
+    size_t len, off;
+} out_queue;
+
+// Encodes the menu into the (empty) queue. Returns the number of bytes queued
+size_t draw_menu(out_queue *q, rlsmenu_str menu_str) {
+    size_t cap = strlen("\e[1;1H") + menu_str.h * (menu_str.w * MB_CUR_MAX + 1);
+    free(q->buf);
+    q->buf = malloc(cap);
+    q->off = 0;
+    q->len = sprintf(q->buf, "\e[1;1H");
+
+    mbstate_t state = { 0 };
+    for (int i = 0; i < menu_str.h; i++) {
+        wchar_t const *row = menu_str.str + i*menu_str.w;
+        size_t n = wcsnrtombs(q->buf + q->len, &row, menu_str.w, cap - q->len, &state);
+        if (n != (size_t) -1)
+            q->len += n;
+        q->buf[q->len++] = '\n';
+    }
+
+    return q->len;
+}
+
+// Writes as much of the queue as the terminal takes. True once it's empty
+bool flush_out(out_queue *q) {
+    while (q->off < q->len) {
+        ssize_t n = write(STDOUT_FILENO, q->buf + q->off, q->len - q->off);
+        if (n < 0) {
+            if (errno == EAGAIN)
+                return false;
+            q->off = q->len; // Nothing to be done, drop the frame
+            break;
+        }
+        q->off += n;
+    }
+
+    return true;
+}
+
+static long now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
+/*
+ * Applies all buffered input before redrawing, and lets the scheduler
+ * decide when a redraw goes out. Bursts of input (e.g. a held arrow key)
+ * only draw the latest state, at most MAX_FPS times a second, within the
+ * output budget, and never while the terminal is still taking the last
+ * frame.
+ */
 int run_menu(rlsmenu_gui *gui) {
-    rlsmenu_str menu_str = rlsmenu_get_menu_str(gui);
-    draw_menu(menu_str);
+    rlsmenu_sched sched;
+    rlsmenu_sched_init(&sched, gui, MAX_FPS, OUT_BYTES_PER_SEC);
+    out_queue out = { 0 };
+
+    // Frames bypass stdio, so whatever main printed has to go out first
+    fflush(stdout);
 
-    int c, in;
+    int c = 0, in;
     enum rlsmenu_result res;
-    while ((c = getchar()) != EOF) {
-        if ((in = translate_input((char) c)) == -1) continue;
-
-        res = rlsmenu_update(gui, in);
-        switch (res) {
-            case RLSMENU_DONE:
-            case RLSMENU_CANCELED:
-                goto out;
-            default:
-                break;
+    for (;;) {
+        bool writable = flush_out(&out);
+        rlsmenu_str menu_str = rlsmenu_sched_poll(&sched, now_ms(), writable);
+        if (!menu_str.str) break;
+        if (menu_str.has_changed) {
+            rlsmenu_sched_wrote(&sched, draw_menu(&out, menu_str));
+            writable = flush_out(&out);
         }
 
-        menu_str = rlsmenu_get_menu_str(gui);
-        if (!menu_str.str) break;
-        if (menu_str.has_changed)
-            draw_menu(menu_str);
+        // Wake for input, for the terminal taking more output, or when the
+        // scheduler allows a pending redraw
+        struct pollfd p[] = {
+            { .fd = STDIN_FILENO, .events = POLLIN },
+            { .fd = STDOUT_FILENO, .events = writable ? 0 : POLLOUT },
+        };
+        poll(p, 2, writable ? rlsmenu_sched_timeout(&sched, now_ms()) : -1);
+
+        while ((c = getchar_nb()) >= 0) {
+            if ((in = translate_input((char) c)) == -1) continue;
+
+            res = rlsmenu_update(gui, in);
+            switch (res) {
+                case RLSMENU_DONE:
+                case RLSMENU_CANCELED:
+                    goto out;
+                default:
+                    break;
+            }
+        }
+
+        if (c == EOF) break;
     }
 
 out:
+    // Let the last frame finish going out
+    while (!flush_out(&out))
+        poll(&(struct pollfd) { .fd = STDOUT_FILENO, .events = POLLOUT }, 1, -1);
+    free(out.buf);
+
     return c == EOF ? EOF : 0;
 }
 
@@ -0,0 +1,266 @@
+/*
+ * End-to-end keystroke-to-screen latency harness. Runs an rlsmenu host
+ * (./demo by default) under a pseudo-terminal, feeds it scripted keys and
+ * times how long each update takes to be fully written to the terminal.
+ *
+ * Each key's update is split from the stream per update, so frames of any
+ * height work. Once an update has sent a cursor home (\e[1;1H), the frame
+ * is over after a short gap of silence (-g, 5ms by default); its latency
+ * is measured up to its last byte, so the gap itself isn't counted. Output
+ * without a cursor home falls back to the settle window of silence (-s,
+ * 50ms by default). A key that produces no output within the settle window
+ * counts as no redraw, so it should exceed the host's longest redraw delay.
+ *
+ * Limits: a host that pauses longer than the gap in the middle of a frame
+ * has the rest of the frame billed to the next key, and several frames
+ * drawn for one key are counted as one update.
+ *
+ * Usage: latency [-n rounds] [-s settle_ms] [-g gap_ms] [-k keys] [-- host args...]
+ *   keys is a comma separated list of up, down, pgup, pgdn, enter, esc or
+ *   single characters. The list is sent n times.
+ */
+#define _GNU_SOURCE
+#include <pty.h>
+#include <stdbool.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define DEFAULT_KEYS "down,down,up,down,up,up"
+#define MAX_KEYS 64
+#define HOME "\e[1;1H"
+
+typedef struct key {
+    char const *name;
+    char const *seq;
+} key;
+
+static key const named_keys[] = {
+    { "up", "\e[A" },
+    { "down", "\e[B" },
+    { "pgup", "\e[5~" },
+    { "pgdn", "\e[6~" },
+    { "enter", "\n" },
+    { "esc", "\e" },
+};
+
+// Looks for HOME in the output stream, which may split it across reads
+typedef struct frame_parser {
+    size_t home; // bytes of HOME matched so far
+} frame_parser;
+
+typedef struct sample {
+    double latency; // seconds, negative if the key produced no output
+    size_t bytes;
+    bool framed;    // whether the update contained a cursor home
+} sample;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int parse_keys(char *spec, char const **seqs) {
+    int n = 0;
+    for (char *tok = strtok(spec, ","); tok; tok = strtok(NULL, ",")) {
+        if (n == MAX_KEYS) {
+            fprintf(stderr, "too many keys (max %d)\n", MAX_KEYS);
+            return -1;
+        }
+
+        char const *seq = NULL;
+        for (size_t i = 0; i < sizeof(named_keys) / sizeof(*named_keys); i++)
+            if (!strcmp(tok, named_keys[i].name))
+                seq = named_keys[i].seq;
+
+        if (!seq && strlen(tok) == 1)
+            seq = tok;
+        if (!seq) {
+            fprintf(stderr, "unknown key '%s'\n", tok);
+            return -1;
+        }
+        seqs[n++] = seq;
+    }
+
+    return n;
+}
+
+// Feeds one byte to the parser. Returns true if it completes a HOME
+static bool parse_byte(frame_parser *fp, char c) {
+    if (c == HOME[fp->home]) {
+        if (++fp->home == strlen(HOME)) {
+            fp->home = 0;
+            return true;
+        }
+        return false;
+    }
+    fp->home = c == HOME[0];
+    return false;
+}
+
+/*
+ * Reads one update from fd and returns its size in bytes, storing the time
+ * of its last byte in last and whether it was a frame in framed. A
+ * negative return means the host went away.
+ */
+static long read_update(int fd, frame_parser *fp, double settle, double gap,
+                        double *last, bool *framed) {
+    char buf[4096];
+    long total = 0;
+    struct pollfd p = { .fd = fd, .events = POLLIN };
+
+    *framed = false;
+    for (;;) {
+        int r = poll(&p, 1, (int) ((*framed ? gap : settle) * 1000));
+        if (r == 0)
+            return total;
+        if (r < 0)
+            return -1;
+
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n <= 0)
+            return total ? total : -1;
+
+        *last = now();
+        total += n;
+        for (ssize_t i = 0; i < n; i++)
+            if (parse_byte(fp, buf[i]))
+                *framed = true;
+    }
+}
+
+static int cmp_double(void const *a, void const *b) {
+    double x = *(double const *) a, y = *(double const *) b;
+    return (x > y) - (x < y);
+}
+
+// Nearest rank percentile of a sorted array
+static double percentile(double const *v, int n, double p) {
+    int rank = (int) (p / 100 * n + 0.999999);
+    if (rank < 1) rank = 1;
+    return v[rank - 1];
+}
+
+int main(int argc, char **argv) {
+    int rounds = 200;
+    double settle = 0.05;
+    double gap = 0.005;
+    char keyspec[1024] = DEFAULT_KEYS;
+    frame_parser fp = { 0 };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:g:k:")) != -1) {
+        switch (opt) {
+            case 'n':
+                rounds = atoi(optarg);
+                break;
+            case 's':
+                settle = atoi(optarg) / 1000.0;
+                break;
+            case 'g':
+                gap = atoi(optarg) / 1000.0;
+                break;
+            case 'k':
+                snprintf(keyspec, sizeof(keyspec), "%s", optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n rounds] [-s settle_ms] [-g gap_ms] [-k keys] [-- host args...]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    char const *seqs[MAX_KEYS];
+    int n_keys = parse_keys(keyspec, seqs);
+    if (n_keys <= 0 || rounds <= 0)
+        return 1;
+
+    char *default_host[] = { "./demo", NULL };
+    char **host = optind < argc ? argv + optind : default_host;
+
+    struct winsize ws = { .ws_row = 60, .ws_col = 240 };
+    int fd;
+    pid_t pid = forkpty(&fd, NULL, NULL, &ws);
+    if (pid < 0) {
+        perror("forkpty");
+        return 1;
+    }
+
+    if (pid == 0) {
+        execvp(host[0], host);
+        perror("execvp");
+        _exit(127);
+    }
+
+    // Wait for the first frame before timing anything
+    double last;
+    bool framed;
+    long startup = read_update(fd, &fp, settle * 5, settle * 5, &last, &framed);
+    if (startup <= 0) {
+        fprintf(stderr, "host produced no output\n");
+        return 1;
+    }
+
+    int total = rounds * n_keys;
+    sample *samples = malloc(sizeof(*samples) * total);
+    int n = 0;
+
+    for (int r = 0; r < rounds; r++) {
+        for (int k = 0; k < n_keys; k++, n++) {
+            size_t len = strlen(seqs[k]);
+            double sent = now();
+            if (write(fd, seqs[k], len) != (ssize_t) len) {
+                perror("write");
+                goto done;
+            }
+
+            last = sent;
+            long bytes = read_update(fd, &fp, settle, gap, &last, &framed);
+            if (bytes < 0) {
+                fprintf(stderr, "host exited after %d keys\n", n);
+                goto done;
+            }
+
+            samples[n].bytes = bytes;
+            samples[n].latency = bytes ? last - sent : -1;
+            samples[n].framed = framed;
+        }
+    }
+
+done:
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    close(fd);
+
+    double *lat = malloc(sizeof(*lat) * (n ? n : 1));
+    int n_drawn = 0, n_framed = 0;
+    size_t bytes = 0;
+    for (int i = 0; i < n; i++) {
+        bytes += samples[i].bytes;
+        n_framed += samples[i].framed;
+        if (samples[i].latency >= 0)
+            lat[n_drawn++] = samples[i].latency * 1e6;
+    }
+    qsort(lat, n_drawn, sizeof(*lat), cmp_double);
+
+    printf("host: %s\n", host[0]);
+    printf("keystrokes: %d (%d redrawn)\n", n, n_drawn);
+    printf("startup output: %ld bytes\n", startup);
+    printf("frame detection: %d by cursor home + %.0fms gap, %d by %.0fms of silence\n",
+           n_framed, gap * 1000, n_drawn - n_framed, settle * 1000);
+    printf("output per keystroke: %.1f bytes\n", n ? (double) bytes / n : 0.0);
+    if (n_drawn) {
+        printf("latency us: p50 %.0f  p90 %.0f  p99 %.0f  max %.0f\n",
+               percentile(lat, n_drawn, 50), percentile(lat, n_drawn, 90),
+               percentile(lat, n_drawn, 99), lat[n_drawn - 1]);
+    }
+
+    free(lat);
+    free(samples);
+    return n == total ? 0 : 1;
+}
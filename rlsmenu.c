@@ -1,10 +1,12 @@
 #include "rlsmenu.h"
+#include "blit.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
 #include <stdio.h>
 #include <assert.h>
+#include <limits.h>
 
 #define max(a,b) \
    ({ __typeof__ (a) _a = (a); \
@@ -37,6 +39,7 @@ static wchar_t *rebuild_rlsmenu_msgbox(rlsmenu_frame *);
 static enum rlsmenu_result update_rlsmenu_slist(rlsmenu_frame *frame, enum rlsmenu_input in);
 static enum rlsmenu_result update_rlsmenu_null(rlsmenu_frame *frame, enum rlsmenu_input in);
 
+static void free_frame(rlsmenu_frame *frame);
 static int longest_item_name(wchar_t const **item_names, int n_items);
 static void draw_border(wchar_t *, int w, int h);
 
@@ -94,7 +97,7 @@ static void clear(node *head, bool deep) {
             rlsmenu_cleanup_cb f = frame->cbs->cleanup;
             if (f) f(frame);
 
-            free(tmp->data);
+            free_frame(frame);
         }
 
         free(tmp);
@@ -113,11 +116,12 @@ enum rlsmenu_result rlsmenu_update(rlsmenu_gui *gui, enum rlsmenu_input in) {
             /* FALLTHROUGH */
         case RLSMENU_CANCELED:
             if (frame->cbs && frame->cbs->cleanup) frame->cbs->cleanup(frame);
-            // Client has to handle return stack
+            // Client has to handle return stack. The parent's cached
+            // string is still valid, so it only has to be handed out again
             node *n = pop(&gui->frame_stack);
-            free(n->data);
+            free_frame(n->data);
             free(n);
-            gui->should_rebuild_menu_str = true;
+            gui->top_changed = true;
             gui->last_return_code = res;
         default:
     }
@@ -187,11 +191,13 @@ static enum rlsmenu_result update_rlsmenu_slist(rlsmenu_frame *frame, enum rlsme
             return RLSMENU_CONT;
         case RLSMENU_UP:
             slist->sel = max(0, slist->sel-1);
-            frame->parent->should_rebuild_menu_str = true;
+            frame->should_rebuild_str = true;
+            frame->parent->top_changed = true;
             return RLSMENU_CONT;
         case RLSMENU_DN:
             slist->sel = min(slist->s.n_items-1, slist->sel+1);
-            frame->parent->should_rebuild_menu_str = true;
+            frame->should_rebuild_str = true;
+            frame->parent->top_changed = true;
             return RLSMENU_CONT;
         default:
             return RLSMENU_CONT;
@@ -201,15 +207,13 @@ static enum rlsmenu_result update_rlsmenu_slist(rlsmenu_frame *frame, enum rlsme
 void rlsmenu_gui_init(rlsmenu_gui *gui) {
     gui->frame_stack = NULL;
     gui->return_stack = NULL;
-    gui->top_menu = NULL;
-    gui->should_rebuild_menu_str = false;
+    gui->top_changed = false;
 }
 
 // Note: This will leak any allocated memory in the return stack
 void rlsmenu_gui_deinit(rlsmenu_gui *gui) {
     clear(gui->frame_stack, true);
     clear(gui->return_stack, false);
-    free(gui->top_menu);
 }
 
 // Init frame will copy the data so we don't change the user's template
@@ -222,8 +226,10 @@ void rlsmenu_gui_push(rlsmenu_gui *gui, rlsmenu_frame *frame) {
 // Returns the copied frame
 static rlsmenu_frame *init_frame(rlsmenu_gui *gui, rlsmenu_frame *frame) {
     frame->parent = gui;
-    gui->should_rebuild_menu_str = true;
+    gui->top_changed = true;
     frame->from_child_frame = false;
+    frame->str = NULL;
+    frame->should_rebuild_str = true;
 
     return menu_init_handler_for[frame->type](frame);
 }
@@ -273,6 +279,11 @@ static rlsmenu_frame *init_rlsmenu_msgbox(rlsmenu_frame *frame) {
     return (rlsmenu_frame *) m;
 }
 
+static void free_frame(rlsmenu_frame *frame) {
+    free(frame->str);
+    free(frame);
+}
+
 static int longest_item_name(wchar_t const **item_names, int n_items) {
     int max = 0, len;
     for (int i = 0; i < n_items; i++)
@@ -287,40 +298,42 @@ rlsmenu_str rlsmenu_get_menu_str(rlsmenu_gui *gui) {
     if (!gui->frame_stack)
         return (rlsmenu_str) { .str = NULL };
 
-    bool has_changed = gui->should_rebuild_menu_str;
-    if (gui->should_rebuild_menu_str)
+    rlsmenu_frame *frame = gui->frame_stack->data;
+    bool has_changed = gui->top_changed;
+    if (frame->should_rebuild_str)
         rebuild_menu_str(gui);
+    gui->top_changed = false;
 
-    rlsmenu_frame *frame = gui->frame_stack->data;
     return (rlsmenu_str) {
         .w = frame->w,
         .h = frame->h,
-        .str = gui->top_menu,
+        .str = frame->str,
         .has_changed = has_changed,
     };
 }
 
 static void rebuild_menu_str(rlsmenu_gui *gui) {
     rlsmenu_frame *frame = gui->frame_stack->data;
-    free(gui->top_menu);
-    gui->top_menu = rebuild_handler_for[frame->type](frame);
-    gui->should_rebuild_menu_str = false;
+    frame->str = rebuild_handler_for[frame->type](frame);
+    frame->should_rebuild_str = false;
 }
 
+// Reuses the frame's cached string if it has one, since w and h are fixed
 static wchar_t *alloc_frame_str(rlsmenu_frame *frame) {
-    wchar_t *str = malloc(sizeof(*str) * (frame->w * frame->h + 1));
-    str[frame->w * frame->h] = L'\0';
+    wchar_t *str = frame->str;
+    if (!str) {
+        str = malloc(sizeof(*str) * (frame->w * frame->h + 1));
+        str[frame->w * frame->h] = L'\0';
+    }
 
-    for (int i = 0; i < frame->w * frame->h; i++)
-        str[i] = L' ';
+    rlsmenu_blit_fill(str, L' ', frame->w * frame->h);
 
     return str;
 }
 
 /*
- * This function employs a number of dirty hacks to avoid the weirdness of
- * swprintf and printing null chars. Consider finding a better way to do
- * this.
+ * Rows are written with rlsmenu_blit_text over the space filled frame, so no null
+ * chars end up in the frame string and no cell is padded twice.
  */
 static wchar_t *rebuild_rlsmenu_list(rlsmenu_frame *frame) {
     rlsmenu_list *list = (rlsmenu_list *) frame;
@@ -330,8 +343,9 @@ static wchar_t *rebuild_rlsmenu_list(rlsmenu_frame *frame) {
     if (frame->flags & RLSMENU_BORDER)
         x_off+=2, y_off++;
 
+    int row_w = frame->w - 2*x_off;
     if (frame->title) {
-        *wcpcpy(str+x_off+y_off*frame->w, frame->title) = L' ';
+        rlsmenu_blit_text(str+x_off+y_off*frame->w, frame->title, row_w);
         y_off++;
     }
 
@@ -341,7 +355,7 @@ static wchar_t *rebuild_rlsmenu_list(rlsmenu_frame *frame) {
 
         str[idx] = L'('; str[idx+1] = is_slist_sel ? L'*' : idx_to_alpha[i];
         str[idx+2] = L')'; str[idx+3] = L' ';
-        *wcpcpy(str+idx+4, list->s.item_names[i]) = L' ';
+        rlsmenu_blit_text(str+idx+MENU_IDX_WIDTH, list->s.item_names[i], row_w-MENU_IDX_WIDTH);
     }
 
     if (frame->flags & RLSMENU_BORDER)
@@ -358,14 +372,18 @@ static wchar_t *rebuild_rlsmenu_msgbox(rlsmenu_frame *frame) {
     if (frame->flags & RLSMENU_BORDER)
         x_off+=2;
 
+    int row_w = frame->w - 2*x_off;
     for (int i = 0; i < m->n_lines; i++)
-        *wcpcpy(str+x_off+(y_off+i)*frame->w, m->lines[i]) = L' ';
+        rlsmenu_blit_text(str+x_off+(y_off+i)*frame->w, m->lines[i], row_w);
 
     if (frame->flags & RLSMENU_BORDER)
         draw_border(str, frame->w, frame->h);
 
-    if (frame->title)
-        *wcpcpy(str+x_off, frame->title) = L' ';
+    // The title sits on the top border, so only pad it by one space
+    if (frame->title) {
+        int title_w = min((int) wcslen(frame->title) + 1, frame->w - x_off - !!(frame->flags & RLSMENU_BORDER));
+        rlsmenu_blit_row(str+x_off, frame->title, title_w, L' ');
+    }
 
     return str;
 }
@@ -376,16 +394,11 @@ static void draw_border(wchar_t *str, int w, int h) {
     str[0+w*(h-1)] = BOX_BL;
     str[w*h-1] = BOX_BR;
 
-    for (int i = 1; i < w-1; i++) {
-        str[i] = BOX_H;
-        str[i + w*(h-1)] = BOX_H;
-    }
-
-    for (int i = 1; i < h-1; i++) {
-        str[i*w] = BOX_V;
-        str[i*w+w-1] = BOX_V;
-    }
+    rlsmenu_blit_hrun(str+1, BOX_H, w-2);
+    rlsmenu_blit_hrun(str+1+w*(h-1), BOX_H, w-2);
 
+    rlsmenu_blit_vrun(str+w, BOX_V, h-2, w);
+    rlsmenu_blit_vrun(str+w+w-1, BOX_V, h-2, w);
 }
 
 void rlsmenu_push_return(rlsmenu_gui *gui, void *data) {
@@ -401,3 +414,86 @@ void *rlsmenu_pop_return(rlsmenu_gui *gui) {
 
     return data;
 }
+
+void rlsmenu_sched_init(rlsmenu_sched *sched, rlsmenu_gui *gui, int max_fps, long bytes_per_sec) {
+    sched->gui = gui;
+    // Round up so the rate never exceeds max_fps
+    sched->min_interval = max_fps > 0 ? (1000 + max_fps - 1) / max_fps : 0;
+    sched->bytes_per_sec = bytes_per_sec;
+    sched->has_flushed = false;
+    sched->last_flush = 0;
+    sched->last_refill = 0;
+    sched->budget = bytes_per_sec * 1000LL;
+}
+
+static bool sched_pending(rlsmenu_sched *sched) {
+    return sched->gui->frame_stack && sched->gui->top_changed;
+}
+
+/*
+ * The budget at time now, topped up since the last refill but capped at
+ * one second's worth of burst. Doesn't change the scheduler.
+ */
+static long long sched_budget_at(rlsmenu_sched *sched, long now) {
+    if (!sched->bytes_per_sec || !sched->has_flushed)
+        return sched->budget;
+
+    long long gained = (long long) (now - sched->last_refill) * sched->bytes_per_sec;
+    return min(sched->budget + gained, sched->bytes_per_sec * 1000LL);
+}
+
+int rlsmenu_sched_timeout(rlsmenu_sched *sched, long now) {
+    if (!sched_pending(sched))
+        return -1;
+
+    if (!sched->has_flushed)
+        return 0;
+
+    long long wait = 0;
+    if (sched->min_interval)
+        wait = sched->last_flush + sched->min_interval - now;
+
+    // Smallest wait that brings the budget above zero
+    long long budget = sched_budget_at(sched, now);
+    if (sched->bytes_per_sec && budget <= 0)
+        wait = max(wait, -budget / sched->bytes_per_sec + 1);
+
+    return (int) min(max(wait, 0LL), (long long) INT_MAX);
+}
+
+rlsmenu_str rlsmenu_sched_poll(rlsmenu_sched *sched, long now, bool writable) {
+    // Handed out when there is nothing to draw, so NULL still means that
+    // there are no frames
+    static wchar_t nothing[1];
+
+    if (!sched->gui->frame_stack)
+        return (rlsmenu_str) { .str = NULL };
+
+    if (sched->has_flushed) {
+        sched->budget = sched_budget_at(sched, now);
+        sched->last_refill = now;
+    }
+
+    bool ready = writable && sched_pending(sched);
+    if (ready && sched->has_flushed) {
+        ready = now - sched->last_flush >= sched->min_interval
+            && (!sched->bytes_per_sec || sched->budget > 0);
+    }
+
+    // Only rebuild when the frame actually goes out, so every state the
+    // redraw skipped over costs nothing
+    if (ready) {
+        if (!sched->has_flushed)
+            sched->last_refill = now;
+        sched->has_flushed = true;
+        sched->last_flush = now;
+        return rlsmenu_get_menu_str(sched->gui);
+    }
+
+    return (rlsmenu_str) { .str = nothing, .has_changed = false };
+}
+
+void rlsmenu_sched_wrote(rlsmenu_sched *sched, long bytes) {
+    if (sched->bytes_per_sec)
+        sched->budget -= bytes * 1000LL;
+}
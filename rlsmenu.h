@@ -26,9 +26,9 @@ typedef struct rlsmenu_gui {
     struct node *frame_stack;
     struct node *return_stack;
 
-    // cached string of the top menu frame
-    wchar_t *top_menu;
-    bool should_rebuild_menu_str;
+    // set when the top frame's string differs from the one last returned
+    // by rlsmenu_get_menu_str
+    bool top_changed;
 
     enum rlsmenu_result last_return_code;
 } rlsmenu_gui;
@@ -56,6 +56,10 @@ typedef struct rlsmenu_frame {
     rlsmenu_gui *parent;
     int w, h;
     bool from_child_frame;
+
+    // cached string of this frame, kept while children are on top of it
+    wchar_t *str;
+    bool should_rebuild_str;
 } rlsmenu_frame;
 
 // The shared fields of lists. All members are public.
@@ -91,6 +95,27 @@ typedef struct rlsmenu_str {
     bool has_changed;
 } rlsmenu_str;
 
+/*
+ * Coalesces redraws of a gui. Input is still applied to the gui right
+ * away, but the menu string is only rebuilt and handed out when the rate
+ * limit and output budget allow, so intermediate frames are dropped. Times
+ * are in milliseconds from any monotonic clock the host likes. All fields
+ * are managed by API functions.
+ */
+typedef struct rlsmenu_sched {
+    rlsmenu_gui *gui;
+
+    int min_interval;  // ms between redraws, 0 for no limit
+    long bytes_per_sec; // output budget, 0 for no limit
+
+    bool has_flushed;
+    long last_flush;
+    long last_refill;
+    // bytes that may still be written, times 1000 so refills of less than
+    // a byte aren't lost. Negative when in debt
+    long long budget;
+} rlsmenu_sched;
+
 // Provides input to a GUI object and updates the state correspondingly
 enum rlsmenu_result rlsmenu_update(rlsmenu_gui *, enum rlsmenu_input);
 
@@ -103,7 +128,14 @@ void rlsmenu_gui_deinit(rlsmenu_gui *gui);
 // Pushes a new GUI frame. Copies frame so the template can be reused
 void rlsmenu_gui_push(rlsmenu_gui *, rlsmenu_frame *);
 
-// Lazily updates and returns the menu string of the top frame
+/*
+ * Lazily updates and returns the menu string of the top frame.
+ *
+ * Note: The string belongs to the top frame. It is rewritten in place when
+ * that frame is rebuilt, and freed when that frame is popped (which can
+ * happen inside rlsmenu_update). Copy it if it's needed after the next
+ * update, e.g. to erase or diff the old menu.
+ */
 rlsmenu_str rlsmenu_get_menu_str(rlsmenu_gui *);
 
 // Pushes a data pointer onto the return stack
@@ -118,3 +150,27 @@ void rlsmenu_push_return(rlsmenu_gui *gui, void *data);
  * rlsmenu_is_return_stack_empty
  */
 void *rlsmenu_pop_return(rlsmenu_gui *gui);
+
+/*
+ * Initializes a scheduler for gui. max_fps and bytes_per_sec limit how
+ * often and how much the host redraws; 0 disables either limit.
+ */
+void rlsmenu_sched_init(rlsmenu_sched *sched, rlsmenu_gui *gui, int max_fps, long bytes_per_sec);
+
+/*
+ * Returns the menu string if the host should redraw now, in which case
+ * has_changed is set. writable is whether the host's output can currently
+ * take a frame. Returns a NULL str if there are no frames. Otherwise, when
+ * there is nothing to draw yet, str is an empty string with w and h of 0.
+ */
+rlsmenu_str rlsmenu_sched_poll(rlsmenu_sched *sched, long now, bool writable);
+
+// Charges bytes written for the last redraw against the output budget
+void rlsmenu_sched_wrote(rlsmenu_sched *sched, long bytes);
+
+/*
+ * Returns how many ms until a pending redraw may happen, 0 if it may
+ * happen now, or -1 if nothing is pending. Suitable as a poll() timeout.
+ * Doesn't change the scheduler, so it can be called any number of times.
+ */
+int rlsmenu_sched_timeout(rlsmenu_sched *sched, long now);
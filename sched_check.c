@@ -0,0 +1,176 @@
+/*
+ * Drives rlsmenu_sched with synthetic timestamps and checks the redraw
+ * decisions it makes. Exits non-zero if any check fails.
+ */
+#include "rlsmenu.h"
+
+#include <stdio.h>
+
+static int failures;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+static char *items[] = { "a", "b", "c" };
+static wchar_t const *item_names[] = { L"One", L"Two", L"Three" };
+static wchar_t const *lines[] = { L"A child message box" };
+
+static rlsmenu_msgbox child_tmp = {
+    .frame = {
+        .type = RLSMENU_MSGBOX,
+        .title = L"Child",
+        .cbs = &(rlsmenu_cbs) { NULL, NULL, NULL },
+    },
+    .lines = lines,
+    .n_lines = 1,
+};
+
+static enum rlsmenu_cb_res open_child(rlsmenu_frame *frame, void *selection) {
+    (void) selection;
+    rlsmenu_gui_push(frame->parent, (rlsmenu_frame *) &child_tmp);
+
+    return RLSMENU_CB_NEW_WIN;
+}
+
+static rlsmenu_slist list_tmp = {
+    .s = {
+        .frame = {
+            .type = RLSMENU_SLIST,
+            .flags = RLSMENU_BORDER,
+            .title = L"Scheduler",
+            .cbs = &(rlsmenu_cbs) { open_child, NULL, NULL },
+        },
+        .items = items,
+        .item_size = sizeof(char *),
+        .n_items = 3,
+        .item_names = item_names,
+    },
+};
+
+static void setup(rlsmenu_gui *gui, rlsmenu_sched *sched, int max_fps, long bytes_per_sec) {
+    rlsmenu_gui_init(gui);
+    rlsmenu_gui_push(gui, (rlsmenu_frame *) &list_tmp);
+    rlsmenu_sched_init(sched, gui, max_fps, bytes_per_sec);
+}
+
+// A child pushed between flushes must not hand out its unbuilt string
+static void check_child_push(void) {
+    rlsmenu_gui gui;
+    rlsmenu_sched sched;
+    setup(&gui, &sched, 60, 0);
+
+    CHECK(rlsmenu_sched_poll(&sched, 1000, true).has_changed);
+
+    rlsmenu_update(&gui, 0);
+    rlsmenu_str s = rlsmenu_sched_poll(&sched, 1005, true);
+    CHECK(s.str != NULL);
+    CHECK(!s.has_changed);
+    CHECK(s.w == 0 && s.h == 0);
+    CHECK(rlsmenu_sched_timeout(&sched, 1005) == 12);
+
+    s = rlsmenu_sched_poll(&sched, 1017, true);
+    CHECK(s.has_changed);
+    CHECK(s.str != NULL && s.w == (int) wcslen(lines[0]));
+
+    rlsmenu_gui_deinit(&gui);
+}
+
+// Input bursts between flushes produce one redraw, at most max_fps a second
+static void check_rate_limit(void) {
+    rlsmenu_gui gui;
+    rlsmenu_sched sched;
+    setup(&gui, &sched, 60, 0);
+
+    int redraws = 0;
+    for (long t = 0; t < 1000; t++) {
+        rlsmenu_update(&gui, t % 2 ? RLSMENU_UP : RLSMENU_DN);
+        if (rlsmenu_sched_poll(&sched, t, true).has_changed)
+            redraws++;
+    }
+    CHECK(redraws <= 60);
+    CHECK(redraws >= 55);
+
+    rlsmenu_gui_deinit(&gui);
+}
+
+// Damage survives polls while the output isn't writable
+static void check_not_writable(void) {
+    rlsmenu_gui gui;
+    rlsmenu_sched sched;
+    setup(&gui, &sched, 0, 0);
+
+    CHECK(!rlsmenu_sched_poll(&sched, 0, false).has_changed);
+    CHECK(rlsmenu_sched_timeout(&sched, 0) == 0);
+    CHECK(rlsmenu_sched_poll(&sched, 1, true).has_changed);
+    CHECK(rlsmenu_sched_timeout(&sched, 1) == -1);
+
+    rlsmenu_gui_deinit(&gui);
+}
+
+// A slow budget polled often still refills, and a debt is never drawn over
+static void check_budget(void) {
+    rlsmenu_gui gui;
+    rlsmenu_sched sched;
+    setup(&gui, &sched, 0, 500);
+
+    CHECK(rlsmenu_sched_poll(&sched, 0, true).has_changed);
+    rlsmenu_sched_wrote(&sched, 1000);
+
+    rlsmenu_update(&gui, RLSMENU_DN);
+    long drawn_at = -1;
+    for (long t = 1; t < 20000 && drawn_at < 0; t++) {
+        // Asking for the timeout must not change the answer
+        int timeout = rlsmenu_sched_timeout(&sched, t);
+        CHECK(timeout == rlsmenu_sched_timeout(&sched, t));
+
+        if (rlsmenu_sched_poll(&sched, t, true).has_changed) {
+            CHECK(timeout == 0);
+            drawn_at = t;
+        }
+    }
+    CHECK(drawn_at == 1001);
+
+    rlsmenu_gui_deinit(&gui);
+
+    // A wait that doesn't divide evenly rounds up
+    setup(&gui, &sched, 0, 5000);
+    CHECK(rlsmenu_sched_poll(&sched, 0, true).has_changed);
+    rlsmenu_sched_wrote(&sched, 5003);
+
+    rlsmenu_update(&gui, RLSMENU_DN);
+    CHECK(rlsmenu_sched_timeout(&sched, 0) == 1);
+    CHECK(!rlsmenu_sched_poll(&sched, 0, true).has_changed);
+    CHECK(rlsmenu_sched_poll(&sched, 1, true).has_changed);
+
+    rlsmenu_gui_deinit(&gui);
+
+    // Budgets past what a 32-bit long can hold in byte-ms
+    setup(&gui, &sched, 0, 3000000);
+    CHECK(rlsmenu_sched_poll(&sched, 0, true).has_changed);
+    rlsmenu_sched_wrote(&sched, 6000000);
+
+    rlsmenu_update(&gui, RLSMENU_DN);
+    CHECK(rlsmenu_sched_timeout(&sched, 0) == 1001);
+    CHECK(!rlsmenu_sched_poll(&sched, 1000, true).has_changed);
+    CHECK(rlsmenu_sched_poll(&sched, 1001, true).has_changed);
+
+    rlsmenu_gui_deinit(&gui);
+}
+
+int main(void) {
+    check_child_push();
+    check_rate_limit();
+    check_not_writable();
+    check_budget();
+
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all scheduler checks passed\n");
+}